@@ -2,15 +2,26 @@
 #include <stddef.h>
 #include <stdio.h>
 #include <errno.h>
+#include <pthread.h>
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
 
 #include "arrow.h"
+#include "arrow_index.h"
 #include "logger.h"
 
 static size_t const DEFAULT_INIT_SIZE = 8;
 
+#ifdef ARROW_PROFILE
+size_t ArrowTable_insert_case_counts[5] = {0};
+#define COUNT_INSERT_CASE(n) (++ArrowTable_insert_case_counts[(n)])
+#else
+#define COUNT_INSERT_CASE(n) ((void)0)
+#endif
+
 /// @brief  The bounds of some index.
 ///
 /// The 'start_idx' is index of the first element.
@@ -142,91 +153,106 @@ is_full_enough_to_grow(struct ArrowTable const *const me)
     return (double)(me->length + 1) / me->capacity >= 0.90;
 }
 
-/// @brief  Insert with the assumption that there's enough room.
-/// @note   This is a clever recursive algorithm (so watch out!).
-static int
-insert_with_enough_room(struct ArrowTable *const me, int const key, int const value)
+static size_t
+next_index(struct ArrowTable const *const me, size_t const idx)
 {
-    // The 'victim' is the one who is kicked out of their current spot,
-    // i.e. the 'rich' in Robin Hood lingo.
-    size_t h = 0, idx = 0, next_idx = 0, victim_idx = 0;
-    int victim_key = 0, victim_value = 0;
-    // NOTE I assume no integer overflow in the length!
-    assert(is_ok(me) && me->length + 1 < me->capacity);
-    assert(key >= 0 && value >= 0);
+    return arrow_next_index(me->capacity, idx);
+}
 
-    h = hash(key);
-    idx = h % me->capacity;
-    next_idx = (idx + 1) % me->capacity;
+static size_t
+distance(struct ArrowTable const *const me, size_t const from, size_t const to)
+{
+    return arrow_distance(me->capacity, from, to);
+}
+
+/// @brief  Return the index that the key in the (filled) cell hashes to.
+static size_t
+home_index(struct ArrowTable const *const me, size_t const idx)
+{
+    assert(cell_filled(me, idx));
+    return hash(me->data[idx].key) % me->capacity;
+}
+
+/// @brief  Find where a new key with the given home should go, i.e. the end
+///         of its home's run of keys.
+static size_t
+find_insert_index(struct ArrowTable const *const me, size_t const idx)
+{
+    size_t const next_idx = next_index(me, idx);
 
     // Cases:
     // 1. Spot empty, invalid arrows: simple insert and update arrows.
     // 2. Spot empty, valid arrows: insert without moving arrows.
-    // 3. Spot filled, invalid arrows: search for next free spot.
-    // 4. Spot filled, valid arrows: insert at tail, evict victim.
+    // 3. Spot filled, invalid arrows: our run is empty, so find where it
+    //    would start (i.e. where the previous run stops).
+    // 4. Spot filled, valid arrows: insert at tail.
     if (!cell_filled(me, idx) && !valid_arrows(me, idx)) {
-        LOGGER_TRACE("Case 1: key=%d, value=%d", key, value);
-        me->data[idx] = (struct ArrowCell){.key = key, .value = value, .arrow = 0};
-        me->data[next_idx].arrow = 0;
-        ++me->length;
-        return 0;
+        COUNT_INSERT_CASE(1);
+        return idx;
     } else if (!cell_filled(me, idx) && valid_arrows(me, idx)) {
-        LOGGER_TRACE("Case 2: key=%d, value=%d", key, value);
+        COUNT_INSERT_CASE(2);
         assert(me->data[idx].arrow == 0 && me->data[next_idx].arrow == 0);
-        me->data[idx].key = key;
-        me->data[idx].value = value;
-        ++me->length;
-        return 0;
+        return idx;
     } else if (cell_filled(me, idx) && !valid_arrows(me, idx)) {
-        LOGGER_TRACE("Case 3: key=%d, value=%d", key, value);
-        // NOTE We already know that the cell at idx is filled.
-        for (size_t i = idx + 1; i != idx; i = (i + 1) % me->capacity) {
-            if (!cell_filled(me, i)) {
-                // TODO Simply fill this spot and adjust the arrows
-                size_t diff = (i + me->capacity - idx) % me->capacity;
-                me->data[i] = (struct ArrowCell){.key = key, .value = value, .arrow = 0};
-                me->data[idx].arrow = diff;
-                me->data[next_idx].arrow = diff;
-                ++me->length;
-                return 0;
-            } else if (count_collisions(me, i) != 0) {
-                struct Bounds b = get_bounds(me, i);
-                // TODO Fill the start_idx spot and adjust the arrows. Recurse on victim.
-                size_t diff = (i + me->capacity - idx) % me->capacity;
-                victim_idx = b.start_idx;
-                victim_key = me->data[victim_idx].key;
-                victim_value = me->data[victim_idx].value;
-                me->data[victim_idx].key = key;
-                me->data[victim_idx].value = value;
-                ++me->data[i].arrow;
-                me->data[idx].arrow = diff;
-                me->data[next_idx].arrow = diff;
-                if (victim_key == -1)
-                    return 0;
-                LOGGER_TRACE("Case 3 (cont'd): victim_key=%d, victim_value=%d", victim_key, victim_value);
-                return insert_with_enough_room(me, victim_key, victim_value);
+        COUNT_INSERT_CASE(3);
+        if (me->data[idx].arrow != -1) {
+            return (idx + me->data[idx].arrow) % me->capacity;
+        }
+        for (size_t i = next_idx; i != idx; i = next_index(me, i)) {
+            if (!cell_filled(me, i) || arrow_is_later_home(me->capacity, idx, home_index(me, i), i)) {
+                return i;
             }
         }
         assert(0 && "IMPOSSIBLE!");
     } else if (cell_filled(me, idx) && valid_arrows(me, idx)) {
-        LOGGER_TRACE("Case 4: key=%d, value=%d", key, value);
-        LOGGER_TRACE("Case 4 (cont'd): idx=%zu", idx);
-        victim_idx = (me->data[next_idx].arrow + next_idx) % me->capacity;
-        LOGGER_TRACE("Case 4 (cont'd): victim_idx=%zu", victim_idx);
-        victim_key = me->data[victim_idx].key;
-        victim_value = me->data[victim_idx].value;
-        me->data[victim_idx].key = key;
-        me->data[victim_idx].value = value;
-        ++me->data[next_idx].arrow;
-        if (victim_key == -1) {
-            ++me->length;
-            return 0;
-        }
-        LOGGER_TRACE("Case 4 (cont'd): victim_key=%d, victim_value=%d", victim_key, victim_value);
-        return insert_with_enough_room(me, victim_key, victim_value);
-    } else {
-        assert(0 && "IMPOSSIBLE!");
+        COUNT_INSERT_CASE(4);
+        return (next_idx + me->data[next_idx].arrow) % me->capacity;
+    }
+    assert(0 && "IMPOSSIBLE!");
+    return SIZE_MAX;
+}
+
+/// @brief  Insert with the assumption that there's enough room and that the
+///         key is not already present.
+/// @note   We shift the keys from the insertion point along by one until the
+///         first empty spot, then bump the arrows of the homes we passed. The
+///         arrows belong to the home indices, so they never move.
+static int
+insert_with_enough_room(struct ArrowTable *const me, int const key, int const value)
+{
+    size_t h = 0, idx = 0, next_idx = 0, insert_idx = 0, empty_idx = 0;
+    // NOTE I assume no integer overflow in the length!
+    assert(is_ok(me) && me->length + 1 < me->capacity);
+    assert(key >= 0 && value >= 0);
+
+    h = hash(key);
+    idx = h % me->capacity;
+    next_idx = next_index(me, idx);
+    LOGGER_TRACE("Insert: key=%d, value=%d, idx=%zu", key, value, idx);
+
+    insert_idx = find_insert_index(me, idx);
+    for (empty_idx = insert_idx; cell_filled(me, empty_idx); empty_idx = next_index(me, empty_idx)) {
+    }
+    for (size_t i = empty_idx; i != insert_idx;) {
+        size_t const prev_i = arrow_prev_index(me->capacity, i);
+        me->data[i].key = me->data[prev_i].key;
+        me->data[i].value = me->data[prev_i].value;
+        i = prev_i;
     }
+    me->data[insert_idx].key = key;
+    me->data[insert_idx].value = value;
+
+    // Every home after ours (up to the empty spot) now starts one later.
+    arrow_adjust_arrows(me->data, sizeof(*me->data), offsetof(struct ArrowCell, arrow),
+                        me->capacity, next_idx, next_index(me, empty_idx), 1);
+    if (me->data[idx].arrow == -1) {
+        me->data[idx].arrow = distance(me, idx, insert_idx);
+    }
+    if (me->data[next_idx].arrow == -1) {
+        me->data[next_idx].arrow = distance(me, idx, insert_idx);
+    }
+    ++me->length;
+    return 0;
 }
 
 /// @brief  Update an existing key or insert a key/value pair.
@@ -286,6 +312,303 @@ grow_hash_table(struct ArrowTable *const me)
     return 0;
 }
 
+////////////////////////////////////////////////////////////////////////////////
+/// BULK BUILD
+////////////////////////////////////////////////////////////////////////////////
+
+/// @brief  Partitions own at most 2^BULK_PARTITION_BITS homes, so that the
+///         counting sort of one partition stays in cache.
+static size_t const BULK_PARTITION_BITS = 16;
+
+/// @brief  An input pair. We recompute its home from the key rather than
+///         storing it, since hashing is cheaper than the extra memory traffic.
+struct BulkEntry {
+    int key;
+    int value;
+};
+
+/// @brief  A contiguous range of home indices [lo_home, hi_home) owned by a
+///         single partition, along with its entries once they are scattered.
+struct BulkPartition {
+    size_t lo_home;
+    size_t hi_home;
+    // Index into the scratch buffer of the first entry in this partition.
+    size_t offset;
+    // Number of entries after removing duplicate keys.
+    size_t length;
+    // The (unwrapped) index one past the last cell this partition fills if
+    // nothing from an earlier partition spills into it.
+    size_t own_end;
+    // The (unwrapped) index at which this partition starts placing entries,
+    // i.e. the max of 'lo_home' and where the previous partition stopped.
+    size_t cursor;
+    // Whether the bucket at 'lo_home - 1' (owned by the previous partition)
+    // is non-empty. This decides whether our first arrow is valid.
+    bool prev_bucket_filled;
+};
+
+/// @brief  State shared between all of the bulk build workers.
+struct BulkShared {
+    struct ArrowTable *table;
+    int const *keys;
+    int const *values;
+    size_t input_length;
+    size_t nthreads;
+    // NOTE The number of partitions is a power of two no smaller than the
+    //      number of threads, so 'home >> partition_shift' is the partition.
+    size_t npartitions;
+    size_t partition_shift;
+    struct BulkPartition *partitions;
+    // Per-thread histograms (then scatter cursors), 'nthreads' x 'npartitions'.
+    size_t *histograms;
+    struct BulkEntry *scratch;
+    // Each thread sorts its partitions into its own slice of 'sort_scratch'
+    // (starting at 'sort_offsets[thread_id]') and counts their homes in its
+    // own 'span + 1' slice of 'sort_counts'.
+    struct BulkEntry *sort_scratch;
+    size_t *sort_offsets;
+    size_t *sort_counts;
+};
+
+struct BulkWorker {
+    struct BulkShared *shared;
+    size_t thread_id;
+};
+
+/// @brief  Choose the capacity that 'ArrowTable_put' would have grown to
+///         after inserting 'length' unique keys.
+/// @note   A put checks 'is_full_enough_to_grow' before it inserts, so after
+///         'length' puts the capacity only has to satisfy length/capacity < 0.9.
+static size_t
+bulk_capacity(size_t const length)
+{
+    size_t capacity = DEFAULT_INIT_SIZE;
+    while ((double)length / capacity >= 0.90) {
+        capacity *= 2;
+    }
+    return capacity;
+}
+
+static size_t
+bulk_home(struct BulkShared const *const shared, int const key)
+{
+    return hash(key) % shared->table->capacity;
+}
+
+static void
+bulk_input_range(struct BulkShared const *const shared,
+                 size_t const thread_id,
+                 size_t *const lo,
+                 size_t *const hi)
+{
+    size_t const chunk = (shared->input_length + shared->nthreads - 1) / shared->nthreads;
+    *lo = thread_id * chunk < shared->input_length ? thread_id * chunk : shared->input_length;
+    *hi = *lo + chunk < shared->input_length ? *lo + chunk : shared->input_length;
+}
+
+/// @brief  Phase 1: invalidate this thread's slice of the cells and count how
+///         many of this thread's inputs land in each partition.
+static void *
+bulk_histogram_worker(void *const arg)
+{
+    struct BulkWorker const *const w = arg;
+    struct BulkShared *const shared = w->shared;
+    struct ArrowTable *const table = shared->table;
+    size_t *const histogram = &shared->histograms[w->thread_id * shared->npartitions];
+    size_t lo = 0, hi = 0;
+
+    size_t const cell_chunk = table->capacity / shared->nthreads + 1;
+    for (size_t i = w->thread_id * cell_chunk; i < (w->thread_id + 1) * cell_chunk && i < table->capacity; ++i) {
+        table->data[i] = (struct ArrowCell){.key = -1, .value = -1, .arrow = -1};
+    }
+
+    bulk_input_range(shared, w->thread_id, &lo, &hi);
+    for (size_t i = lo; i < hi; ++i) {
+        ++histogram[bulk_home(shared, shared->keys[i]) >> shared->partition_shift];
+    }
+    return NULL;
+}
+
+/// @brief  Phase 2: hash this thread's inputs a second time and scatter them
+///         into the partitions at the offsets reserved for this thread.
+/// @note   Each thread's entries land after those of the earlier threads and
+///         in input order, so each partition keeps the input order.
+static void *
+bulk_scatter_worker(void *const arg)
+{
+    struct BulkWorker const *const w = arg;
+    struct BulkShared *const shared = w->shared;
+    size_t *const cursors = &shared->histograms[w->thread_id * shared->npartitions];
+    size_t lo = 0, hi = 0;
+
+    bulk_input_range(shared, w->thread_id, &lo, &hi);
+    for (size_t i = lo; i < hi; ++i) {
+        size_t const dst = cursors[bulk_home(shared, shared->keys[i]) >> shared->partition_shift]++;
+        shared->scratch[dst] = (struct BulkEntry){.key = shared->keys[i], .value = shared->values[i]};
+    }
+    return NULL;
+}
+
+/// @brief  Phase 3: counting sort each of this thread's partitions by home,
+///         drop the duplicate keys, and find where each partition would end
+///         on its own.
+/// @note   The partition is in input order and the counting sort is stable,
+///         so the last of each home's duplicates is from the latest input.
+static void *
+bulk_sort_worker(void *const arg)
+{
+    struct BulkWorker const *const w = arg;
+    struct BulkShared *const shared = w->shared;
+    size_t const span = (size_t)1 << shared->partition_shift;
+    struct BulkEntry *const sorted = &shared->sort_scratch[shared->sort_offsets[w->thread_id]];
+    size_t *const counts = &shared->sort_counts[w->thread_id * (span + 1)];
+
+    for (size_t p = w->thread_id; p < shared->npartitions; p += shared->nthreads) {
+        struct BulkPartition *const part = &shared->partitions[p];
+        struct BulkEntry *const entries = &shared->scratch[part->offset];
+        size_t end = part->lo_home, unique = 0;
+
+        // Count each home's entries, then turn the counts into the offset
+        // of each home's first entry.
+        memset(counts, 0, (span + 1) * sizeof(*counts));
+        for (size_t i = 0; i < part->length; ++i) {
+            ++counts[bulk_home(shared, entries[i].key) - part->lo_home + 1];
+        }
+        for (size_t h = 1; h <= span; ++h) {
+            counts[h] += counts[h - 1];
+        }
+        for (size_t i = 0; i < part->length; ++i) {
+            sorted[counts[bulk_home(shared, entries[i].key) - part->lo_home]++] = entries[i];
+        }
+        // Now counts[h] is where home 'h' ends. Copy each home's entries back
+        // from the last input to the first, so the last duplicate wins.
+        for (size_t h = 0; h < span; ++h) {
+            size_t const begin = h ? counts[h - 1] : 0, first_unique = unique;
+            for (size_t i = counts[h]; i-- > begin;) {
+                bool seen = false;
+                for (size_t j = first_unique; j < unique && !seen; ++j) {
+                    seen = entries[j].key == sorted[i].key;
+                }
+                if (!seen) {
+                    entries[unique++] = sorted[i];
+                }
+            }
+            // Place each entry in the first free cell at or after its home.
+            if (unique != first_unique) {
+                end = (part->lo_home + h > end ? part->lo_home + h : end) + (unique - first_unique);
+            }
+        }
+        part->length = unique;
+        part->own_end = end;
+    }
+    return NULL;
+}
+
+/// @brief  Phase 4: write this thread's partitions' cells and arrows.
+/// @note   Partitions write disjoint cells, so no synchronization is needed.
+static void *
+bulk_write_worker(void *const arg)
+{
+    struct BulkWorker const *const w = arg;
+    struct BulkShared *const shared = w->shared;
+    struct ArrowTable *const table = shared->table;
+    size_t const capacity = table->capacity;
+
+    for (size_t p = w->thread_id; p < shared->npartitions; p += shared->nthreads) {
+        struct BulkPartition const *const part = &shared->partitions[p];
+        struct BulkEntry const *const entries = &shared->scratch[part->offset];
+        size_t cursor = part->cursor, i = 0;
+        size_t entry_home = part->length ? bulk_home(shared, entries[0].key) : part->hi_home;
+        bool prev_filled = part->prev_bucket_filled;
+
+        for (size_t h = part->lo_home; h < part->hi_home; ++h) {
+            size_t const start = cursor > h ? cursor : h;
+            bool const filled = entry_home == h;
+            // NOTE Only the arrows of non-empty buckets and their successors
+            //      are valid, just as if they were inserted one at a time.
+            if (filled || prev_filled) {
+                table->data[h].arrow = (int)(start - h);
+            }
+            cursor = start;
+            for (; entry_home == h; ++cursor) {
+                table->data[cursor % capacity].key = entries[i].key;
+                table->data[cursor % capacity].value = entries[i].value;
+                entry_home = ++i < part->length ? bulk_home(shared, entries[i].key) : part->hi_home;
+            }
+            prev_filled = filled;
+        }
+    }
+    return NULL;
+}
+
+/// @brief  Run one phase of the bulk build across all of the threads.
+static int
+bulk_run_phase(struct BulkShared *const shared, void *(*const phase)(void *))
+{
+    int err = 0;
+    size_t spawned = 0;
+    pthread_t *const threads = calloc(shared->nthreads, sizeof(*threads));
+    struct BulkWorker *const workers = calloc(shared->nthreads, sizeof(*workers));
+    if (threads == NULL || workers == NULL) {
+        assert(errno);
+        err = errno;
+        goto cleanup;
+    }
+    for (size_t t = 0; t < shared->nthreads; ++t) {
+        workers[t] = (struct BulkWorker){.shared = shared, .thread_id = t};
+    }
+    // NOTE The calling thread does the first chunk of work itself.
+    for (spawned = 1; spawned < shared->nthreads; ++spawned) {
+        if ((err = pthread_create(&threads[spawned], NULL, phase, &workers[spawned]))) {
+            break;
+        }
+    }
+    phase(&workers[0]);
+    for (size_t t = 1; t < spawned; ++t) {
+        pthread_join(threads[t], NULL);
+    }
+    // If we failed to spawn every thread, finish their work here.
+    for (size_t t = spawned; t < shared->nthreads; ++t) {
+        phase(&workers[t]);
+    }
+    err = 0;
+cleanup:
+    free(threads);
+    free(workers);
+    return err;
+}
+
+/// @brief  Resolve, in order, where each partition actually starts placing
+///         entries, given how far the previous partitions spill over.
+/// @note   Partition 'p' on its own ends at 'own_end'; if entries spill into
+///         it from the left so that it starts at 'cursor' instead, then it
+///         ends at max(own_end, cursor + length). The last partition may spill
+///         around into the first, so repeat until the carry stops changing.
+static void
+bulk_resolve_cursors(struct BulkShared *const shared)
+{
+    size_t const capacity = shared->table->capacity;
+    size_t carry = 0, prev_carry = SIZE_MAX;
+
+    while (carry != prev_carry) {
+        size_t end = carry;
+        prev_carry = carry;
+        for (size_t p = 0; p < shared->npartitions; ++p) {
+            struct BulkPartition *const part = &shared->partitions[p];
+            part->cursor = end > part->lo_home ? end : part->lo_home;
+            end = part->own_end > part->cursor + part->length ? part->own_end : part->cursor + part->length;
+        }
+        carry = end > capacity ? end - capacity : 0;
+    }
+    for (size_t p = 0; p < shared->npartitions; ++p) {
+        struct BulkPartition const *const prev =
+            &shared->partitions[(p + shared->npartitions - 1) % shared->npartitions];
+        shared->partitions[p].prev_bucket_filled =
+            prev->length != 0 &&
+            bulk_home(shared, shared->scratch[prev->offset + prev->length - 1].key) == prev->hi_home - 1;
+    }
+}
+
 ////////////////////////////////////////////////////////////////////////////////
 /// EXTERNAL FUNCTIONS
 ////////////////////////////////////////////////////////////////////////////////
@@ -313,6 +636,141 @@ ArrowTable_init(struct ArrowTable *const me)
     return 0;
 }
 
+int
+ArrowTable_bulk_init(struct ArrowTable *const me,
+                     int const *const keys,
+                     int const *const values,
+                     size_t const length,
+                     size_t nthreads)
+{
+    int err = 0;
+    struct BulkShared shared = {0};
+    size_t entry_idx = 0;
+
+    if (me == NULL || me->data != NULL || me->length != 0 || me->capacity != 0) {
+        return -1;
+    }
+    if (length != 0 && (keys == NULL || values == NULL)) {
+        return -1;
+    }
+    for (size_t i = 0; i < length; ++i) {
+        if (keys[i] < 0 || values[i] < 0) {
+            return -1;
+        }
+    }
+    if (nthreads == 0) {
+        long const nprocs = sysconf(_SC_NPROCESSORS_ONLN);
+        nthreads = nprocs > 0 ? (size_t)nprocs : 1;
+    }
+    // Extra threads would have no input to hash, only empty histograms.
+    if (nthreads > length) {
+        nthreads = length ? length : 1;
+    }
+
+    // NOTE We size for 'length' keys, so duplicates may leave extra room.
+    me->capacity = bulk_capacity(length);
+    shared = (struct BulkShared){
+        .table = me,
+        .keys = keys,
+        .values = values,
+        .input_length = length,
+        .nthreads = nthreads,
+        .npartitions = 1,
+        .partition_shift = 0,
+    };
+    while (shared.npartitions < nthreads && shared.npartitions < me->capacity) {
+        shared.npartitions *= 2;
+    }
+    while ((me->capacity >> BULK_PARTITION_BITS) > shared.npartitions) {
+        shared.npartitions *= 2;
+    }
+    while ((me->capacity >> shared.partition_shift) > shared.npartitions) {
+        ++shared.partition_shift;
+    }
+
+    me->data = malloc(me->capacity * sizeof(*me->data));
+    shared.partitions = calloc(shared.npartitions, sizeof(*shared.partitions));
+    shared.histograms = calloc(nthreads * shared.npartitions, sizeof(*shared.histograms));
+    shared.scratch = malloc((length ? length : 1) * sizeof(*shared.scratch));
+    if (me->data == NULL || shared.partitions == NULL || shared.histograms == NULL ||
+        shared.scratch == NULL) {
+        assert(errno);
+        err = errno;
+        goto error_cleanup;
+    }
+
+    if ((err = bulk_run_phase(&shared, bulk_histogram_worker))) {
+        goto error_cleanup;
+    }
+    // Turn the per-thread histograms into scatter cursors. Each partition's
+    // entries are contiguous and, within a partition, grouped by thread.
+    for (size_t p = 0; p < shared.npartitions; ++p) {
+        struct BulkPartition *const part = &shared.partitions[p];
+        part->lo_home = p << shared.partition_shift;
+        part->hi_home = (p + 1) << shared.partition_shift;
+        part->offset = entry_idx;
+        for (size_t t = 0; t < nthreads; ++t) {
+            size_t const cnt = shared.histograms[t * shared.npartitions + p];
+            shared.histograms[t * shared.npartitions + p] = entry_idx;
+            entry_idx += cnt;
+        }
+        part->length = entry_idx - part->offset;
+    }
+    assert(entry_idx == length);
+    // Each thread needs room to sort the largest of its partitions.
+    shared.sort_offsets = calloc(nthreads + 1, sizeof(*shared.sort_offsets));
+    if (shared.sort_offsets == NULL) {
+        assert(errno);
+        err = errno;
+        goto error_cleanup;
+    }
+    for (size_t t = 0; t < nthreads; ++t) {
+        size_t largest = 0;
+        for (size_t p = t; p < shared.npartitions; p += nthreads) {
+            largest = shared.partitions[p].length > largest ? shared.partitions[p].length : largest;
+        }
+        shared.sort_offsets[t + 1] = shared.sort_offsets[t] + largest;
+    }
+    shared.sort_scratch = malloc((shared.sort_offsets[nthreads] ? shared.sort_offsets[nthreads] : 1) *
+                                 sizeof(*shared.sort_scratch));
+    shared.sort_counts =
+        malloc(nthreads * (((size_t)1 << shared.partition_shift) + 1) * sizeof(*shared.sort_counts));
+    if (shared.sort_scratch == NULL || shared.sort_counts == NULL) {
+        assert(errno);
+        err = errno;
+        goto error_cleanup;
+    }
+    if ((err = bulk_run_phase(&shared, bulk_scatter_worker)) ||
+        (err = bulk_run_phase(&shared, bulk_sort_worker))) {
+        goto error_cleanup;
+    }
+    bulk_resolve_cursors(&shared);
+    if ((err = bulk_run_phase(&shared, bulk_write_worker))) {
+        goto error_cleanup;
+    }
+    me->length = 0;
+    for (size_t p = 0; p < shared.npartitions; ++p) {
+        me->length += shared.partitions[p].length;
+    }
+
+    free(shared.partitions);
+    free(shared.histograms);
+    free(shared.scratch);
+    free(shared.sort_scratch);
+    free(shared.sort_offsets);
+    free(shared.sort_counts);
+    return 0;
+error_cleanup:
+    free(shared.partitions);
+    free(shared.histograms);
+    free(shared.scratch);
+    free(shared.sort_scratch);
+    free(shared.sort_offsets);
+    free(shared.sort_counts);
+    ArrowTable_destroy(me);
+    return err;
+}
+
 int
 ArrowTable_destroy(struct ArrowTable *const me)
 {
@@ -373,5 +831,115 @@ ArrowTable_put(struct ArrowTable *const me, int const key, int const value)
 int
 ArrowTable_remove(struct ArrowTable *const me, int const key)
 {
+    size_t h = 0, idx = 0, next_idx = 0, prev_idx = 0, rm_idx = 0, stop_idx = 0, last_idx = 0;
+    bool now_empty = false;
+
+    if (!is_ok(me) || key < 0) {
+        return -1;
+    }
+    rm_idx = get_index(me, key);
+    if (rm_idx == SIZE_MAX) {
+        return -1;
+    }
+    h = hash(key);
+    idx = h % me->capacity;
+    next_idx = next_index(me, idx);
+    prev_idx = arrow_prev_index(me->capacity, idx);
+    now_empty = count_collisions(me, idx) == 1;
+
+    // Shift the following keys back by one until we reach an empty spot or a
+    // key that is already in its home (which therefore cannot move back).
+    for (stop_idx = next_index(me, rm_idx);
+         cell_filled(me, stop_idx) && arrow_can_shift_back(home_index(me, stop_idx), stop_idx);
+         stop_idx = next_index(me, stop_idx)) {
+    }
+    last_idx = rm_idx;
+    for (size_t i = next_index(me, rm_idx); i != stop_idx; i = next_index(me, i)) {
+        me->data[last_idx].key = me->data[i].key;
+        me->data[last_idx].value = me->data[i].value;
+        last_idx = i;
+    }
+    me->data[last_idx].key = -1;
+    me->data[last_idx].value = -1;
+
+    // Every home after ours (up to the last shifted key) now starts one earlier.
+    arrow_adjust_arrows(me->data, sizeof(*me->data), offsetof(struct ArrowCell, arrow),
+                        me->capacity, next_idx, stop_idx, -1);
+    // An empty home only needs arrows to mark where its neighbours' runs
+    // stop and start.
+    if (now_empty) {
+        if (count_collisions(me, prev_idx) == 0) {
+            me->data[idx].arrow = -1;
+        }
+        if (count_collisions(me, next_idx) == 0) {
+            me->data[next_idx].arrow = -1;
+        }
+    }
+    --me->length;
+    return 0;
+}
+
+int
+ArrowTable_memory_usage(struct ArrowTable const *const me, struct ArrowTableMemoryUsage *const usage)
+{
+    if (!is_ok(me) || usage == NULL) {
+        return -1;
+    }
+    // NOTE Growing allocates the doubled cells before freeing the old ones.
+    *usage = (struct ArrowTableMemoryUsage){
+        .live_bytes = me->length * sizeof(*me->data),
+        .reserved_bytes = me->capacity * sizeof(*me->data),
+        .peak_resize_bytes = 3 * me->capacity * sizeof(*me->data),
+    };
+    return 0;
+}
+
+int
+ArrowTable_validate(struct ArrowTable const *const me)
+{
+    size_t length = 0, bucket_lengths = 0;
+
+    if (!is_ok(me)) {
+        return -1;
+    }
+    for (size_t i = 0; i < me->capacity; ++i) {
+        size_t const prev_i = arrow_prev_index(me->capacity, i);
+        int const arrow = me->data[i].arrow;
+        if (arrow < -1 || arrow >= (int)me->capacity) {
+            LOGGER_ERROR("arrow out of range: idx=%zu, arrow=%d", i, arrow);
+            return -1;
+        }
+        // An arrow is valid exactly when its home or the previous home has keys.
+        if ((arrow != -1) != (count_collisions(me, i) != 0 || count_collisions(me, prev_i) != 0)) {
+            LOGGER_ERROR("arrow validity mismatch: idx=%zu, arrow=%d", i, arrow);
+            return -1;
+        }
+        if (!cell_filled(me, i)) {
+            if (me->data[i].value != -1 || (arrow != -1 && arrow != 0)) {
+                LOGGER_ERROR("bad empty cell: idx=%zu, value=%d, arrow=%d", i, me->data[i].value, arrow);
+                return -1;
+            }
+            continue;
+        }
+        ++length;
+        if (me->data[i].key < 0 || me->data[i].value < 0) {
+            LOGGER_ERROR("negative key or value: idx=%zu", i);
+            return -1;
+        }
+        // Every key must lie within the bounds of its home's run.
+        size_t const home = home_index(me, i);
+        struct Bounds const b = get_bounds(me, home);
+        if (count_collisions(me, home) == 0 ||
+            distance(me, b.start_idx, i) >= distance(me, b.start_idx, b.stop_idx)) {
+            LOGGER_ERROR("key outside its bucket: idx=%zu, key=%d, home=%zu", i, me->data[i].key, home);
+            return -1;
+        }
+        bucket_lengths += count_collisions(me, i);
+    }
+    // If the runs overlapped, then their lengths would sum to too much.
+    if (length != me->length || bucket_lengths != me->length) {
+        LOGGER_ERROR("length mismatch: length=%zu, cells=%zu, buckets=%zu", me->length, length, bucket_lengths);
+        return -1;
+    }
     return 0;
 }
@@ -25,10 +25,44 @@ struct ArrowTable {
     size_t capacity;
 };
 
+/// @brief  How many bytes a table uses.
+struct ArrowTableMemoryUsage {
+    // Bytes of the cells (and keys) that hold a key/value pair.
+    size_t live_bytes;
+    // Bytes currently allocated.
+    size_t reserved_bytes;
+    // Bytes that will be allocated at the peak of the next grow, when both
+    // the old and new cells are allocated.
+    size_t peak_resize_bytes;
+};
+
+#ifdef ARROW_PROFILE
+/// @brief  How many times each case (1-4) of the insertion algorithm has run.
+///         Index 0 is unused.
+/// @note   This is only compiled in with -DARROW_PROFILE.
+extern size_t ArrowTable_insert_case_counts[5];
+#endif
 
 int
 ArrowTable_init(struct ArrowTable *const me);
 
+/// @brief  Initialize the ArrowTable directly from unsorted key/value pairs.
+/// @note   The contents are the same as calling 'ArrowTable_put' on each
+///         pair in order (so the last duplicate key wins), but this hashes,
+///         partitions by home index, and writes the cells across 'nthreads'
+///         threads. An 'nthreads' of 0 uses every online CPU, and 'nthreads'
+///         is capped at 'length'.
+/// @note   The capacity is what 'length' unique keys would grow to, so input
+///         with many duplicate keys ends up with a larger capacity than the
+///         equivalent 'ArrowTable_put' calls would give.
+/// @return Return 0 on success; other codes result from failure.
+int
+ArrowTable_bulk_init(struct ArrowTable *const me,
+                     int const *const keys,
+                     int const *const values,
+                     size_t const length,
+                     size_t nthreads);
+
 int
 ArrowTable_destroy(struct ArrowTable *const me);
 
@@ -49,3 +83,15 @@ ArrowTable_put(struct ArrowTable *const me, int const key, int const value);
 /// @return Return 0 on success; other codes result from failure.
 int
 ArrowTable_remove(struct ArrowTable *const me, int const key);
+
+/// @brief  Report how many bytes the ArrowTable uses.
+/// @note   This does not include the heap allocator's own overhead.
+/// @return Return 0 on success; other codes result from failure.
+int
+ArrowTable_memory_usage(struct ArrowTable const *const me, struct ArrowTableMemoryUsage *const usage);
+
+/// @brief  Check the arrows, bucket bounds, and length of the ArrowTable.
+/// @note   This is slow (O(capacity)) and is meant for testing.
+/// @return Return 0 if the ArrowTable is consistent; -1 otherwise.
+int
+ArrowTable_validate(struct ArrowTable const *const me);
@@ -0,0 +1,74 @@
+/** @brief  Index arithmetic shared by the ArrowTable and ArrowStrTable.
+ *  @note   Both tables lay their keys out the same way: each home's keys are
+ *          in one contiguous (possibly wrapping) run, the runs are in home
+ *          order, and each home's arrow is the offset from the home to the
+ *          start of its run. Only the cell types differ, so the logic that
+ *          decides which keys and arrows move lives here.
+ */
+#pragma once
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+static inline size_t
+arrow_next_index(size_t const capacity, size_t const idx)
+{
+    return (idx + 1) % capacity;
+}
+
+static inline size_t
+arrow_prev_index(size_t const capacity, size_t const idx)
+{
+    return (idx + capacity - 1) % capacity;
+}
+
+/// @brief  Return the number of steps from idx 'from' forward to idx 'to'.
+static inline size_t
+arrow_distance(size_t const capacity, size_t const from, size_t const to)
+{
+    return (to + capacity - from) % capacity;
+}
+
+/// @brief  Return whether the key at 'idx' (whose home is 'key_home') belongs
+///         to a home after 'home', when scanning forward from 'home'.
+/// @note   A key whose home is in (home, idx] is closer to its home than to
+///         ours, so it belongs to a later home.
+static inline bool
+arrow_is_later_home(size_t const capacity, size_t const home, size_t const key_home, size_t const idx)
+{
+    return arrow_distance(capacity, key_home, idx) < arrow_distance(capacity, home, idx);
+}
+
+/// @brief  Return whether the key at 'idx' can move back by one on a removal,
+///         i.e. whether it is not at its home.
+static inline bool
+arrow_can_shift_back(size_t const key_home, size_t const idx)
+{
+    return key_home != idx;
+}
+
+/// @brief  Add 'delta' to every valid arrow of the homes in [first, stop).
+/// @note   The cells are an array of 'capacity' cells of 'cell_size' bytes,
+///         each with an int arrow at 'arrow_offset' (like qsort(3), this
+///         lets both tables share it). Insertion passes the homes after the
+///         new key's home up to and including the empty spot it filled;
+///         removal passes the homes after the removed key's home up to (but
+///         not including) the first key that did not move back.
+static inline void
+arrow_adjust_arrows(void *const cells,
+                    size_t const cell_size,
+                    size_t const arrow_offset,
+                    size_t const capacity,
+                    size_t const first,
+                    size_t const stop,
+                    int const delta)
+{
+    for (size_t i = first; i != stop; i = arrow_next_index(capacity, i)) {
+        int *const arrow = (int *)((char *)cells + i * cell_size + arrow_offset);
+        if (*arrow != -1) {
+            *arrow += delta;
+            assert(*arrow >= 0);
+        }
+    }
+}
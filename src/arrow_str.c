@@ -0,0 +1,589 @@
+#include <assert.h>
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "arrow_index.h"
+#include "arrow_str.h"
+#include "logger.h"
+
+static size_t const DEFAULT_INIT_SIZE = 8;
+static size_t const DEFAULT_ARENA_SIZE = 64;
+static uint32_t const INVALID_KEY_LENGTH = UINT32_MAX;
+
+/// @brief  32-bit FNV-1a.
+static uint32_t
+hash(char const *const key, size_t const key_length)
+{
+    uint32_t h = 2166136261u;
+    for (size_t i = 0; i < key_length; ++i) {
+        h ^= (unsigned char)key[i];
+        h *= 16777619u;
+    }
+    return h;
+}
+
+static bool
+is_ok(struct ArrowStrTable const *const me)
+{
+    // Short-circuit is OK! We won't dereference a NULL pointer.
+    return me != NULL && me->data != NULL && me->capacity > 0;
+}
+
+static size_t
+next_index(struct ArrowStrTable const *const me, size_t const idx)
+{
+    return arrow_next_index(me->capacity, idx);
+}
+
+static size_t
+distance(struct ArrowStrTable const *const me, size_t const from, size_t const to)
+{
+    return arrow_distance(me->capacity, from, to);
+}
+
+static size_t
+home_index(struct ArrowStrTable const *const me, size_t const idx)
+{
+    return me->data[idx].hash % me->capacity;
+}
+
+/// @brief  Return whether there is a valid key/value pair residing in the cell.
+static bool
+cell_filled(struct ArrowStrTable const *const me, size_t const idx)
+{
+    assert(is_ok(me) && idx < me->capacity);
+    return me->data[idx].key_length != INVALID_KEY_LENGTH;
+}
+
+static bool
+arrow_valid(struct ArrowStrTable const *const me, size_t const idx)
+{
+    assert(is_ok(me) && idx < me->capacity);
+    return me->data[idx].arrow != -1;
+}
+
+/// @brief  Return whether there are valid arrows in the cell idx and idx+1.
+/// @note   See the comment on 'valid_arrows' in arrow.c.
+static bool
+valid_arrows(struct ArrowStrTable const *const me, size_t const idx)
+{
+    return arrow_valid(me, idx) && arrow_valid(me, next_index(me, idx));
+}
+
+static size_t
+bucket_start(struct ArrowStrTable const *const me, size_t const idx)
+{
+    assert(arrow_valid(me, idx));
+    return (idx + me->data[idx].arrow) % me->capacity;
+}
+
+static size_t
+bucket_stop(struct ArrowStrTable const *const me, size_t const idx)
+{
+    size_t const next_idx = next_index(me, idx);
+    assert(arrow_valid(me, next_idx));
+    return (next_idx + me->data[next_idx].arrow) % me->capacity;
+}
+
+/// @brief  Return whether any keys have their home at idx.
+/// @note   The arrows of an empty home whose cell is empty are both zero, so
+///         we must check the cell before trusting the arrows.
+static bool
+bucket_filled(struct ArrowStrTable const *const me, size_t const idx)
+{
+    return cell_filled(me, idx) && valid_arrows(me, idx) &&
+           bucket_start(me, idx) != bucket_stop(me, idx);
+}
+
+static char const *
+cell_key(struct ArrowStrTable const *const me, size_t const idx)
+{
+    struct ArrowStrCell const *const cell = &me->data[idx];
+    assert(cell_filled(me, idx));
+    if (cell->key_length <= ARROW_STR_INLINE_SIZE) {
+        return cell->key.inline_key;
+    }
+    return &me->arena.data[cell->key.offset];
+}
+
+/// @brief  Copy a key into the arena (or the cell itself if it is short).
+static int
+store_key(struct ArrowStrArena *const arena,
+          struct ArrowStrCell *const cell,
+          char const *const key,
+          size_t const key_length)
+{
+    assert(key_length < INVALID_KEY_LENGTH);
+    cell->key_length = key_length;
+    if (key_length <= ARROW_STR_INLINE_SIZE) {
+        memset(cell->key.inline_key, 0, ARROW_STR_INLINE_SIZE);
+        memcpy(cell->key.inline_key, key, key_length);
+        return 0;
+    }
+    // NOTE Offsets are only 32 bits to keep the cells small.
+    if (arena->length + key_length > UINT32_MAX) {
+        return EOVERFLOW;
+    }
+    if (arena->length + key_length > arena->capacity) {
+        size_t new_capacity = arena->capacity ? arena->capacity : DEFAULT_ARENA_SIZE;
+        while (arena->length + key_length > new_capacity) {
+            new_capacity *= 2;
+        }
+        char *const new_data = realloc(arena->data, new_capacity);
+        if (new_data == NULL) {
+            assert(errno);
+            return errno;
+        }
+        arena->data = new_data;
+        arena->capacity = new_capacity;
+    }
+    memcpy(&arena->data[arena->length], key, key_length);
+    cell->key.offset = arena->length;
+    arena->length += key_length;
+    return 0;
+}
+
+/// @brief  Move a key/value pair from one cell to another.
+/// @note   The arrows belong to the home index, not to the key, so they stay put.
+static void
+move_entry(struct ArrowStrCell *const dst, struct ArrowStrCell const *const src)
+{
+    int const arrow = dst->arrow;
+    *dst = *src;
+    dst->arrow = arrow;
+}
+
+static void
+clear_entry(struct ArrowStrCell *const cell)
+{
+    cell->key_length = INVALID_KEY_LENGTH;
+    cell->hash = 0;
+    cell->value = -1;
+}
+
+/// @brief  Get the index of a key/value pair or return SIZE_MAX if it's not present.
+/// @note   We compare the cached hash and length first, so we expect to
+///         compare the key itself at most once for a successful lookup.
+static size_t
+get_index(struct ArrowStrTable const *const me,
+          char const *const key,
+          size_t const key_length,
+          uint32_t const h)
+{
+    size_t const home = h % me->capacity;
+    if (!bucket_filled(me, home)) {
+        return SIZE_MAX;
+    }
+    size_t const stop = bucket_stop(me, home);
+    for (size_t idx = bucket_start(me, home); idx != stop; idx = next_index(me, idx)) {
+        struct ArrowStrCell const *const cell = &me->data[idx];
+        if (cell->hash == h && cell->key_length == key_length &&
+            memcmp(cell_key(me, idx), key, key_length) == 0) {
+            return idx;
+        }
+    }
+    return SIZE_MAX;
+}
+
+/// @note   Arbitrarily set the threshold to grow at 90% full.
+static bool
+is_full_enough_to_grow(struct ArrowStrTable const *const me)
+{
+    assert(is_ok(me));
+    return (double)(me->length + 1) / me->capacity >= 0.90;
+}
+
+/// @brief  Find where a new key with the given home should go, i.e. the end
+///         of its home's run of keys.
+static size_t
+find_insert_index(struct ArrowStrTable const *const me, size_t const home)
+{
+    // Cases (numbered as in arrow.c):
+    // 1. Spot empty, invalid arrows: simple insert and update arrows.
+    // 2. Spot empty, valid arrows: insert without moving arrows.
+    // 3. Spot filled, invalid arrows: our run is empty, so find where it
+    //    would start (i.e. where the previous run stops).
+    // 4. Spot filled, valid arrows: insert at tail.
+    if (!cell_filled(me, home) && !valid_arrows(me, home)) {
+        return home;
+    } else if (!cell_filled(me, home) && valid_arrows(me, home)) {
+        assert(me->data[home].arrow == 0 && me->data[next_index(me, home)].arrow == 0);
+        return home;
+    } else if (cell_filled(me, home) && !valid_arrows(me, home)) {
+        if (arrow_valid(me, home)) {
+            return bucket_start(me, home);
+        }
+        for (size_t idx = next_index(me, home); idx != home; idx = next_index(me, idx)) {
+            if (!cell_filled(me, idx) || arrow_is_later_home(me->capacity, home, home_index(me, idx), idx)) {
+                return idx;
+            }
+        }
+        assert(0 && "IMPOSSIBLE!");
+    } else if (cell_filled(me, home) && valid_arrows(me, home)) {
+        return bucket_stop(me, home);
+    }
+    assert(0 && "IMPOSSIBLE!");
+    return SIZE_MAX;
+}
+
+/// @brief  Insert with the assumption that there's enough room and that the
+///         key is not already present.
+/// @note   We shift the keys after the insertion point along by one until
+///         the first empty spot, then bump the arrows of the homes we passed.
+static void
+insert_with_enough_room(struct ArrowStrTable *const me, struct ArrowStrCell const *const entry)
+{
+    size_t home = 0, idx = 0, empty_idx = 0;
+    // NOTE I assume no integer overflow in the length!
+    assert(is_ok(me) && me->length + 1 < me->capacity);
+
+    home = entry->hash % me->capacity;
+    idx = find_insert_index(me, home);
+    for (empty_idx = idx; cell_filled(me, empty_idx); empty_idx = next_index(me, empty_idx)) {
+    }
+    for (size_t i = empty_idx; i != idx;) {
+        size_t const prev_i = arrow_prev_index(me->capacity, i);
+        move_entry(&me->data[i], &me->data[prev_i]);
+        i = prev_i;
+    }
+    move_entry(&me->data[idx], entry);
+
+    // Every home after ours (up to the empty spot) now starts one later.
+    arrow_adjust_arrows(me->data, sizeof(*me->data), offsetof(struct ArrowStrCell, arrow),
+                        me->capacity, next_index(me, home), next_index(me, empty_idx), 1);
+    if (!arrow_valid(me, home)) {
+        me->data[home].arrow = distance(me, home, idx);
+    }
+    if (!arrow_valid(me, next_index(me, home))) {
+        me->data[next_index(me, home)].arrow = distance(me, home, idx);
+    }
+    ++me->length;
+}
+
+static int
+init_cells(struct ArrowStrTable *const me, size_t const capacity)
+{
+    me->data = calloc(capacity, sizeof(*me->data));
+    if (me->data == NULL) {
+        assert(errno);
+        return errno;
+    }
+    // Set all of the cells to the INVALID state.
+    for (size_t i = 0; i < capacity; ++i) {
+        clear_entry(&me->data[i]);
+        me->data[i].arrow = -1;
+    }
+    me->length = 0;
+    me->capacity = capacity;
+    return 0;
+}
+
+/// @brief  Return whether the removed keys take up more of the arena than
+///         the live keys do, and enough of it to pay for compacting.
+/// @note   Compacting rehashes every cell, so we also wait until the removed
+///         keys take up more bytes than the cells. Otherwise, a large table
+///         with few keys in the arena would rehash on nearly every put.
+static bool
+is_wasteful_enough_to_compact(struct ArrowStrTable const *const me)
+{
+    assert(is_ok(me) && me->arena.dead_length <= me->arena.length);
+    return me->arena.dead_length > me->arena.length - me->arena.dead_length &&
+           me->arena.dead_length > me->capacity * sizeof(*me->data);
+}
+
+/// @brief  Rebuild the hash table with the given capacity.
+/// @note   We copy the live keys into a fresh arena as we go, which compacts
+///         away the keys that were removed.
+static int
+rehash_hash_table(struct ArrowStrTable *const me, size_t const new_capacity)
+{
+    int err = 0;
+    struct ArrowStrTable new_table = {0};
+
+    assert(is_ok(me) && me->length + 1 < new_capacity);
+
+    if ((err = init_cells(&new_table, new_capacity))) {
+        return err;
+    }
+    for (size_t i = 0; i < me->capacity; ++i) {
+        struct ArrowStrCell entry = {0};
+        if (!cell_filled(me, i)) {
+            continue;
+        }
+        entry = me->data[i];
+        if ((err = store_key(&new_table.arena, &entry, cell_key(me, i), entry.key_length))) {
+            ArrowStrTable_destroy(&new_table);
+            return err;
+        }
+        insert_with_enough_room(&new_table, &entry);
+    }
+    // Cleanup temporary structures
+    ArrowStrTable_destroy(me);
+    *me = new_table;
+    return 0;
+}
+
+////////////////////////////////////////////////////////////////////////////////
+/// EXTERNAL FUNCTIONS
+////////////////////////////////////////////////////////////////////////////////
+
+int
+ArrowStrTable_init(struct ArrowStrTable *const me)
+{
+    if (me == NULL || me->data != NULL || me->length != 0 || me->capacity != 0) {
+        return -1;
+    }
+    // NOTE The arena is allocated lazily, so short keys never touch it.
+    me->arena = (struct ArrowStrArena){0};
+    return init_cells(me, DEFAULT_INIT_SIZE);
+}
+
+int
+ArrowStrTable_destroy(struct ArrowStrTable *const me)
+{
+    if (me == NULL) {
+        return -1;
+    }
+    free(me->data);
+    free(me->arena.data);
+    *me = (struct ArrowStrTable){0};
+    return 0;
+}
+
+void
+ArrowStrTable_print(struct ArrowStrTable const *const me, FILE *const stream, bool const newline)
+{
+    if (!me || stream == NULL) return;
+    fprintf(stream, "ArrowStrTable(.data={\n");
+    for (size_t i = 0; i < me->capacity; ++i) {
+        if (cell_filled(me, i)) {
+            fprintf(stream, "\t%zu: {.key=\"%.*s\",.value=%d,.arrow=%d},\n", i,
+                    (int)me->data[i].key_length, cell_key(me, i), me->data[i].value, me->data[i].arrow);
+        } else {
+            fprintf(stream, "\t%zu: {.key=NULL,.value=%d,.arrow=%d},\n", i, me->data[i].value, me->data[i].arrow);
+        }
+    }
+    fprintf(stream, "}, .length = %zu, .capacity = %zu, .arena.length = %zu)",
+            me->length, me->capacity, me->arena.length);
+    if (newline) fprintf(stream, "\n");
+}
+
+int
+ArrowStrTable_get(struct ArrowStrTable const *const me,
+                  char const *const key,
+                  size_t const key_length)
+{
+    size_t idx = 0;
+
+    if (!is_ok(me) || (key == NULL && key_length != 0) || key_length >= INVALID_KEY_LENGTH) {
+        return -1;
+    }
+
+    idx = get_index(me, key, key_length, hash(key, key_length));
+    if (idx == SIZE_MAX)
+        return -1;
+    assert(idx < me->capacity);
+    assert(me->data[idx].value >= 0);
+    return me->data[idx].value;
+}
+
+int
+ArrowStrTable_put(struct ArrowStrTable *const me,
+                  char const *const key,
+                  size_t const key_length,
+                  int const value)
+{
+    int err = 0;
+    size_t idx = 0;
+    uint32_t h = 0;
+    struct ArrowStrCell entry = {0};
+
+    if (!is_ok(me) || (key == NULL && key_length != 0) ||
+        key_length >= INVALID_KEY_LENGTH || value < 0) {
+        return -1;
+    }
+    h = hash(key, key_length);
+    idx = get_index(me, key, key_length, h);
+    if (idx != SIZE_MAX) {
+        me->data[idx].value = value;
+        return 0;
+    }
+    if (is_full_enough_to_grow(me)) {
+        if ((err = rehash_hash_table(me, 2 * me->capacity))) {
+            return err;
+        }
+    } else if (is_wasteful_enough_to_compact(me)) {
+        // NOTE Without this, put/remove churn grows the arena without bound
+        //      (until the 32-bit offsets overflow) even at a steady length.
+        if ((err = rehash_hash_table(me, me->capacity))) {
+            return err;
+        }
+    }
+    entry = (struct ArrowStrCell){.hash = h, .value = value, .arrow = -1};
+    if ((err = store_key(&me->arena, &entry, key, key_length))) {
+        return err;
+    }
+    LOGGER_TRACE("Insert: key=%.*s, value=%d", (int)key_length, key, value);
+    insert_with_enough_room(me, &entry);
+    return 0;
+}
+
+int
+ArrowStrTable_remove(struct ArrowStrTable *const me,
+                     char const *const key,
+                     size_t const key_length)
+{
+    size_t home = 0, idx = 0, stop_idx = 0, last_idx = 0;
+    bool now_empty = false;
+
+    if (!is_ok(me) || (key == NULL && key_length != 0) || key_length >= INVALID_KEY_LENGTH) {
+        return -1;
+    }
+    uint32_t const h = hash(key, key_length);
+    idx = get_index(me, key, key_length, h);
+    if (idx == SIZE_MAX) {
+        return -1;
+    }
+    home = h % me->capacity;
+    now_empty = distance(me, bucket_start(me, home), bucket_stop(me, home)) == 1;
+    if (me->data[idx].key_length > ARROW_STR_INLINE_SIZE) {
+        me->arena.dead_length += me->data[idx].key_length;
+    }
+
+    // Shift the following keys back by one until we reach an empty spot or a
+    // key that is already in its home (which therefore cannot move back).
+    for (stop_idx = next_index(me, idx);
+         cell_filled(me, stop_idx) && arrow_can_shift_back(home_index(me, stop_idx), stop_idx);
+         stop_idx = next_index(me, stop_idx)) {
+    }
+    last_idx = idx;
+    for (size_t i = next_index(me, idx); i != stop_idx; i = next_index(me, i)) {
+        move_entry(&me->data[last_idx], &me->data[i]);
+        last_idx = i;
+    }
+    clear_entry(&me->data[last_idx]);
+
+    // Every home after ours (up to the last shifted key) now starts one earlier.
+    arrow_adjust_arrows(me->data, sizeof(*me->data), offsetof(struct ArrowStrCell, arrow),
+                        me->capacity, next_index(me, home), stop_idx, -1);
+    // An empty home only needs arrows to mark the end of its predecessor's run
+    // and the start of its successor's.
+    if (now_empty) {
+        size_t const prev_home = arrow_prev_index(me->capacity, home);
+        size_t const next_home = next_index(me, home);
+        if (!bucket_filled(me, prev_home)) {
+            me->data[home].arrow = -1;
+        }
+        if (!bucket_filled(me, next_home)) {
+            me->data[next_home].arrow = -1;
+        }
+    }
+    --me->length;
+    return 0;
+}
+
+int
+ArrowStrTable_memory_usage(struct ArrowStrTable const *const me,
+                           struct ArrowTableMemoryUsage *const usage)
+{
+    size_t live_key_bytes = 0, new_arena_capacity = 0;
+
+    if (!is_ok(me) || usage == NULL) {
+        return -1;
+    }
+    for (size_t i = 0; i < me->capacity; ++i) {
+        if (cell_filled(me, i) && me->data[i].key_length > ARROW_STR_INLINE_SIZE) {
+            live_key_bytes += me->data[i].key_length;
+        }
+    }
+    // Growing copies the live keys into a new arena, which doubles from the
+    // default size until they fit.
+    if (live_key_bytes != 0) {
+        new_arena_capacity = DEFAULT_ARENA_SIZE;
+        while (new_arena_capacity < live_key_bytes) {
+            new_arena_capacity *= 2;
+        }
+    }
+    *usage = (struct ArrowTableMemoryUsage){
+        .live_bytes = me->length * sizeof(*me->data) + live_key_bytes,
+        .reserved_bytes = me->capacity * sizeof(*me->data) + me->arena.capacity,
+    };
+    usage->peak_resize_bytes =
+        usage->reserved_bytes + 2 * me->capacity * sizeof(*me->data) + new_arena_capacity;
+    return 0;
+}
+
+int
+ArrowStrTable_validate(struct ArrowStrTable const *const me)
+{
+    size_t length = 0, bucket_lengths = 0, live_key_bytes = 0;
+
+    if (!is_ok(me)) {
+        return -1;
+    }
+    for (size_t i = 0; i < me->capacity; ++i) {
+        size_t const prev_i = arrow_prev_index(me->capacity, i);
+        struct ArrowStrCell const *const cell = &me->data[i];
+        if (cell->arrow < -1 || cell->arrow >= (int)me->capacity) {
+            LOGGER_ERROR("arrow out of range: idx=%zu, arrow=%d", i, cell->arrow);
+            return -1;
+        }
+        // An arrow is valid exactly when its home or the previous home has keys.
+        if (arrow_valid(me, i) != (bucket_filled(me, i) || bucket_filled(me, prev_i))) {
+            LOGGER_ERROR("arrow validity mismatch: idx=%zu, arrow=%d", i, cell->arrow);
+            return -1;
+        }
+        if (!cell_filled(me, i)) {
+            if (cell->value != -1 || (arrow_valid(me, i) && cell->arrow != 0)) {
+                LOGGER_ERROR("bad empty cell: idx=%zu, value=%d, arrow=%d", i, cell->value, cell->arrow);
+                return -1;
+            }
+            continue;
+        }
+        ++length;
+        if (cell->value < 0) {
+            LOGGER_ERROR("negative value: idx=%zu", i);
+            return -1;
+        }
+        if (cell->key_length > ARROW_STR_INLINE_SIZE) {
+            if ((size_t)cell->key.offset + cell->key_length > me->arena.length) {
+                LOGGER_ERROR("key outside the arena: idx=%zu, offset=%u", i, cell->key.offset);
+                return -1;
+            }
+            live_key_bytes += cell->key_length;
+        }
+        if (hash(cell_key(me, i), cell->key_length) != cell->hash) {
+            LOGGER_ERROR("stale cached hash: idx=%zu", i);
+            return -1;
+        }
+        // Every key must lie within the bounds of its home's run.
+        size_t const home = home_index(me, i);
+        if (!bucket_filled(me, home) ||
+            distance(me, bucket_start(me, home), i) >=
+                distance(me, bucket_start(me, home), bucket_stop(me, home))) {
+            LOGGER_ERROR("key outside its bucket: idx=%zu, home=%zu", i, home);
+            return -1;
+        }
+        if (bucket_filled(me, i)) {
+            bucket_lengths += distance(me, bucket_start(me, i), bucket_stop(me, i));
+        }
+    }
+    // If the runs overlapped, then their lengths would sum to too much.
+    if (length != me->length || bucket_lengths != me->length) {
+        LOGGER_ERROR("length mismatch: length=%zu, cells=%zu, buckets=%zu", me->length, length, bucket_lengths);
+        return -1;
+    }
+    // Every used byte of the arena belongs to a live key or a removed one.
+    if (me->arena.length < live_key_bytes ||
+        me->arena.length != live_key_bytes + me->arena.dead_length) {
+        LOGGER_ERROR("arena mismatch: length=%zu, live=%zu, dead=%zu",
+                     me->arena.length, live_key_bytes, me->arena.dead_length);
+        return -1;
+    }
+    return 0;
+}
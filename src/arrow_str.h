@@ -0,0 +1,101 @@
+/** @brief  A string-keyed version of the Arrow Table.
+ *  @note   Keys are copied into an append-only arena that is owned by the
+ *          table, so there is no allocation per key. Keys of at most
+ *          ARROW_STR_INLINE_SIZE bytes are stored directly in the cell.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "arrow.h"
+
+#define ARROW_STR_INLINE_SIZE 8
+
+/// NOTE    Values must be non-negative! This is simply for ease of implementation.
+struct ArrowStrCell {
+    union {
+        // Keys of at most ARROW_STR_INLINE_SIZE bytes live in the cell.
+        char inline_key[ARROW_STR_INLINE_SIZE];
+        // Longer keys live at this offset in the table's arena.
+        uint32_t offset;
+    } key;
+    // Cached hash of the key. We compare this before the key itself and
+    // reuse it to find the new home when we grow.
+    uint32_t hash;
+    // A key_length of UINT32_MAX signals an INVALID cell.
+    uint32_t key_length;
+    // A value of -1 would signal an error in the 'get' function.
+    int value;
+    // An arrow of -1 signals INVALID
+    int arrow;
+};
+
+/// @brief  Append-only storage for the keys that don't fit inline.
+/// @note   Removed keys are reclaimed when the table grows, or when they take
+///         up more bytes than both the live keys and the cells do.
+struct ArrowStrArena {
+    char *data;
+    // Number of bytes used in the arena
+    size_t length;
+    // Number of bytes allocated for the arena
+    size_t capacity;
+    // Number of used bytes that belong to removed keys
+    size_t dead_length;
+};
+
+struct ArrowStrTable {
+    struct ArrowStrCell *data;
+    // Number of elements in the ArrowStrTable
+    size_t length;
+    // Number of slots in the ArrowStrTable
+    size_t capacity;
+    struct ArrowStrArena arena;
+};
+
+int
+ArrowStrTable_init(struct ArrowStrTable *const me);
+
+int
+ArrowStrTable_destroy(struct ArrowStrTable *const me);
+
+void
+ArrowStrTable_print(struct ArrowStrTable const *const me, FILE *const stream, bool const newline);
+
+/// @brief  Get a value from the ArrowStrTable.
+/// @return Returns the value or -1 on failure.
+int
+ArrowStrTable_get(struct ArrowStrTable const *const me,
+                  char const *const key,
+                  size_t const key_length);
+
+/// @brief  Put a value into the ArrowStrTable. The key is copied.
+/// @return Return 0 on success; other codes result from failure.
+int
+ArrowStrTable_put(struct ArrowStrTable *const me,
+                  char const *const key,
+                  size_t const key_length,
+                  int const value);
+
+/// @brief  Delete a key, value pair from the ArrowStrTable.
+/// @return Return 0 on success; other codes result from failure.
+int
+ArrowStrTable_remove(struct ArrowStrTable *const me,
+                     char const *const key,
+                     size_t const key_length);
+
+/// @brief  Check the arrows, bucket bounds, length, and arena of the ArrowStrTable.
+/// @note   This is slow (O(capacity)) and is meant for testing.
+/// @return Return 0 if the ArrowStrTable is consistent; -1 otherwise.
+int
+ArrowStrTable_validate(struct ArrowStrTable const *const me);
+
+/// @brief  Report how many bytes the ArrowStrTable uses, including its arena.
+/// @note   This scans the cells to count the live bytes in the arena, so it is
+///         O(capacity).
+/// @return Return 0 on success; other codes result from failure.
+int
+ArrowStrTable_memory_usage(struct ArrowStrTable const *const me,
+                           struct ArrowTableMemoryUsage *const usage);
@@ -0,0 +1,183 @@
+/** @brief  Differential tester that runs every operation on the ArrowTable
+ *          (and ArrowStrTable) alongside a trivially correct reference map.
+ *  @note   This is shared by the fuzz target and the stress test. Any mismatch
+ *          or broken invariant aborts, so that fuzzers see it as a crash.
+ */
+#pragma once
+
+#include <assert.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "arrow.h"
+#include "arrow_str.h"
+
+/// Keys are in [0, DIFFERENTIAL_MAX_KEY) so the reference can be an array.
+#define DIFFERENTIAL_MAX_KEY (1 << 16)
+
+enum DifferentialOp {
+    DIFFERENTIAL_GET,
+    DIFFERENTIAL_PUT,
+    DIFFERENTIAL_REMOVE,
+    // Rebuild the ArrowTable from the reference with 'ArrowTable_bulk_init'.
+    DIFFERENTIAL_BULK,
+    DIFFERENTIAL_NUM_OPS,
+};
+
+struct Differential {
+    struct ArrowTable table;
+    struct ArrowStrTable str_table;
+    // The value of each key, or -1 if it is absent.
+    int reference[DIFFERENTIAL_MAX_KEY];
+    size_t length;
+};
+
+#define DIFFERENTIAL_CHECK(cond, ...)                                          \
+    do {                                                                       \
+        if (!(cond)) {                                                         \
+            fprintf(stderr, "[ %s:%d ] check '%s' failed: ", __FILE__, __LINE__, #cond); \
+            fprintf(stderr, __VA_ARGS__);                                      \
+            fprintf(stderr, "\n");                                             \
+            abort();                                                           \
+        }                                                                      \
+    } while (0)
+
+/// @brief  Format the string version of a key. Odd keys are long enough to
+///         live in the arena; even keys are stored inline.
+static inline size_t
+_differential_str_key(int const key, char *const buf, size_t const size)
+{
+    int const n = key % 2 ? snprintf(buf, size, "/api/v1/sessions/%d", key)
+                          : snprintf(buf, size, "%d", key);
+    assert(n > 0 && (size_t)n < size);
+    return (size_t)n;
+}
+
+/// @return Returns NULL on allocation failure.
+static inline struct Differential *
+differential_new(void)
+{
+    struct Differential *const me = calloc(1, sizeof(*me));
+    if (me == NULL) {
+        return NULL;
+    }
+    if (ArrowTable_init(&me->table) || ArrowStrTable_init(&me->str_table)) {
+        ArrowTable_destroy(&me->table);
+        ArrowStrTable_destroy(&me->str_table);
+        free(me);
+        return NULL;
+    }
+    for (size_t i = 0; i < DIFFERENTIAL_MAX_KEY; ++i) {
+        me->reference[i] = -1;
+    }
+    return me;
+}
+
+static inline void
+differential_free(struct Differential *const me)
+{
+    if (me == NULL) {
+        return;
+    }
+    ArrowTable_destroy(&me->table);
+    ArrowStrTable_destroy(&me->str_table);
+    free(me);
+}
+
+static inline void
+_differential_bulk(struct Differential *const me, size_t const nthreads)
+{
+    int *const keys = malloc((me->length + 1) * sizeof(*keys));
+    int *const values = malloc((me->length + 1) * sizeof(*values));
+    size_t n = 0;
+    DIFFERENTIAL_CHECK(keys != NULL && values != NULL, "out of memory");
+    for (int key = 0; key < DIFFERENTIAL_MAX_KEY; ++key) {
+        if (me->reference[key] != -1) {
+            keys[n] = key;
+            values[n] = me->reference[key];
+            ++n;
+        }
+    }
+    DIFFERENTIAL_CHECK(n == me->length, "n=%zu, length=%zu", n, me->length);
+    ArrowTable_destroy(&me->table);
+    DIFFERENTIAL_CHECK(ArrowTable_bulk_init(&me->table, keys, values, n, nthreads) == 0,
+                       "n=%zu, nthreads=%zu", n, nthreads);
+    free(keys);
+    free(values);
+}
+
+/// @brief  Apply one operation to the tables and the reference, and check
+///         that they agree and that the ArrowTable's invariants hold.
+static inline void
+differential_step(struct Differential *const me,
+                  enum DifferentialOp const op,
+                  int const key,
+                  int const value)
+{
+    char str_key[32] = {0};
+    size_t const str_key_length = _differential_str_key(key, str_key, sizeof(str_key));
+    int const expected = me->reference[key];
+    int result = 0, str_result = 0;
+
+    assert(key >= 0 && key < DIFFERENTIAL_MAX_KEY && value >= 0);
+    switch (op) {
+    case DIFFERENTIAL_GET:
+        result = ArrowTable_get(&me->table, key);
+        str_result = ArrowStrTable_get(&me->str_table, str_key, str_key_length);
+        DIFFERENTIAL_CHECK(result == expected, "GET %d = %d, expected %d", key, result, expected);
+        DIFFERENTIAL_CHECK(str_result == expected, "GET '%s' = %d, expected %d", str_key, str_result, expected);
+        // Nothing was mutated, so there is nothing more to check.
+        return;
+    case DIFFERENTIAL_PUT:
+        result = ArrowTable_put(&me->table, key, value);
+        str_result = ArrowStrTable_put(&me->str_table, str_key, str_key_length, value);
+        DIFFERENTIAL_CHECK(result == 0, "PUT %d %d = %d", key, value, result);
+        DIFFERENTIAL_CHECK(str_result == 0, "PUT '%s' %d = %d", str_key, value, str_result);
+        me->length += expected == -1;
+        me->reference[key] = value;
+        break;
+    case DIFFERENTIAL_REMOVE:
+        result = ArrowTable_remove(&me->table, key);
+        str_result = ArrowStrTable_remove(&me->str_table, str_key, str_key_length);
+        DIFFERENTIAL_CHECK((result == 0) == (expected != -1), "REMOVE %d = %d, expected %d", key, result, expected);
+        DIFFERENTIAL_CHECK((str_result == 0) == (expected != -1), "REMOVE '%s' = %d, expected %d", str_key, str_result, expected);
+        me->length -= expected != -1;
+        me->reference[key] = -1;
+        break;
+    case DIFFERENTIAL_BULK:
+        // Use the value to pick the thread count, so fuzzers can vary it.
+        _differential_bulk(me, 1 + value % 4);
+        break;
+    default:
+        assert(0 && "IMPOSSIBLE!");
+    }
+    DIFFERENTIAL_CHECK(me->table.length == me->length, "length=%zu, expected %zu", me->table.length, me->length);
+    DIFFERENTIAL_CHECK(me->str_table.length == me->length, "str length=%zu, expected %zu", me->str_table.length, me->length);
+    DIFFERENTIAL_CHECK(ArrowTable_validate(&me->table) == 0, "invalid after op=%d, key=%d", op, key);
+    DIFFERENTIAL_CHECK(ArrowStrTable_validate(&me->str_table) == 0, "invalid str table after op=%d, key=%d", op, key);
+    // The key we just touched must read back correctly.
+    result = ArrowTable_get(&me->table, key);
+    str_result = ArrowStrTable_get(&me->str_table, str_key, str_key_length);
+    DIFFERENTIAL_CHECK(result == me->reference[key], "GET %d = %d, expected %d", key, result, me->reference[key]);
+    DIFFERENTIAL_CHECK(str_result == me->reference[key], "GET '%s' = %d, expected %d", str_key, str_result, me->reference[key]);
+}
+
+/// @brief  Check every key in [0, max_key) (slow).
+/// @note   Callers that only use part of the key domain should pass a tighter
+///         bound, since this formats a string key for every key it checks.
+static inline void
+differential_check_all(struct Differential const *const me, int const max_key)
+{
+    char str_key[32] = {0};
+    assert(max_key <= DIFFERENTIAL_MAX_KEY);
+    for (int key = 0; key < max_key; ++key) {
+        size_t const str_key_length = _differential_str_key(key, str_key, sizeof(str_key));
+        int const result = ArrowTable_get(&me->table, key);
+        int const str_result = ArrowStrTable_get(&me->str_table, str_key, str_key_length);
+        DIFFERENTIAL_CHECK(result == me->reference[key], "GET %d = %d, expected %d", key, result, me->reference[key]);
+        DIFFERENTIAL_CHECK(str_result == me->reference[key], "GET '%s' = %d, expected %d", str_key, str_result, me->reference[key]);
+    }
+}
@@ -0,0 +1,90 @@
+/** @brief  Differential fuzz target for the ArrowTable.
+ *  @note   Build with -DARROW_LIBFUZZER and -fsanitize=fuzzer for libFuzzer.
+ *          Otherwise, this builds a driver that runs each file named on the
+ *          command line (or stdin), which works with AFL and for replaying
+ *          crashes.
+ *
+ *          Each operation is 4 bytes of input: the op, the key (2 bytes,
+ *          little endian), and the value.
+ */
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "differential.h"
+
+// NOTE We keep the keys in a small range so that they collide (since the
+//      hash is the identity) and so that removes hit existing keys.
+static int const FUZZ_KEY_MASK = 0x3ff;
+// Keys are at most FUZZ_KEY_MASK shifted left by 3.
+static int const FUZZ_MAX_KEY = (FUZZ_KEY_MASK << 3) + 1;
+
+int
+LLVMFuzzerTestOneInput(uint8_t const *const data, size_t const size)
+{
+    struct Differential *const diff = differential_new();
+    if (diff == NULL) {
+        return 0;
+    }
+    for (size_t i = 0; i + 4 <= size; i += 4) {
+        // Make bulk builds rare, since they are much slower than the rest.
+        enum DifferentialOp const op = data[i] == 0xff ? DIFFERENTIAL_BULK : data[i] % DIFFERENTIAL_BULK;
+        // Scale the key by the top bits so that we get long runs that wrap.
+        int const raw_key = data[i + 1] | (data[i + 2] << 8);
+        int const key = (raw_key & FUZZ_KEY_MASK) << (raw_key >> 14);
+        differential_step(diff, op, key, data[i + 3]);
+    }
+    differential_check_all(diff, FUZZ_MAX_KEY);
+    differential_free(diff);
+    return 0;
+}
+
+#ifndef ARROW_LIBFUZZER
+static int
+run_file(FILE *const fp)
+{
+    size_t length = 0, capacity = 4096;
+    uint8_t *data = malloc(capacity);
+    size_t n = 0;
+    if (data == NULL) {
+        return -1;
+    }
+    while ((n = fread(&data[length], 1, capacity - length, fp)) > 0) {
+        length += n;
+        if (length == capacity) {
+            uint8_t *const new_data = realloc(data, 2 * capacity);
+            if (new_data == NULL) {
+                free(data);
+                return -1;
+            }
+            data = new_data;
+            capacity *= 2;
+        }
+    }
+    LLVMFuzzerTestOneInput(data, length);
+    free(data);
+    return 0;
+}
+
+int
+main(int argc, char *argv[])
+{
+    if (argc == 1) {
+        return run_file(stdin);
+    }
+    for (int i = 1; i < argc; ++i) {
+        FILE *const fp = fopen(argv[i], "rb");
+        if (fp == NULL) {
+            printf("'%s' path DNE\n", argv[i]);
+            return 1;
+        }
+        if (run_file(fp)) {
+            fclose(fp);
+            return 1;
+        }
+        fclose(fp);
+    }
+    return 0;
+}
+#endif
@@ -5,9 +5,12 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <unistd.h>
 
 #include "arrow.h"
+#include "arrow_str.h"
 #include "logger.h"
+#include "profiler.h"
 
 /// @brief  Wrapper around 'perror' and 'strerror' functions.
 static void
@@ -58,13 +61,18 @@ run_simple_trace()
     return 0;
 }
 
+/// @brief  Run the trace, checking every result.
+/// @param  profiler: if non-NULL, count the events around each operation and
+///         print a per-operation-type report at the end.
 static int
-run_trace(char const *const trace_path)
+run_trace(char const *const trace_path, struct Profiler const *const profiler)
 {
     char op_str[4] = {0};
-    int key = 0, value = 0;
+    int key = 0, value = 0, result = 0;
     int err = 0;
     struct ArrowTable a = {0};
+    struct ProfilerSample sample = {0};
+    struct ProfilerTotals get_totals = {0}, put_totals = {0};
 
     assert(trace_path != NULL);
 
@@ -85,14 +93,39 @@ run_trace(char const *const trace_path)
         if (fscanf(fp, "%3s %d %d", op_str, &key, &value) != 3)
             break;
         LOGGER_TRACE("%s, %d, %d", op_str, key, value);
+        // NOTE We check the results outside of the profiled region.
         if (strcmp(op_str, "GET") == 0) {
-            assert(ArrowTable_get(&a, key) == value);
+            if (profiler) profiler_read(profiler, &sample);
+            result = ArrowTable_get(&a, key);
+            if (profiler) profiler_accumulate(profiler, &sample, &get_totals);
+            assert(result == value);
         } else if (strcmp(op_str, "PUT") == 0) {
-            assert(ArrowTable_put(&a, key, value) == 0);
+            if (profiler) profiler_read(profiler, &sample);
+            result = ArrowTable_put(&a, key, value);
+            if (profiler) profiler_accumulate(profiler, &sample, &put_totals);
+            assert(result == 0);
         } else {
             assert(0 && "IMPOSSIBLE!");
         }
     }
+    fclose(fp);
+
+    if (profiler) {
+        printf("Profile of '%s'%s\n", trace_path,
+               profiler->num_open ? "" : " (no perf counters; TSC only)");
+        profiler_print(profiler, "GET", &get_totals, stdout);
+        profiler_print(profiler, "PUT", &put_totals, stdout);
+#ifdef ARROW_PROFILE
+        printf("Insert cases: 1=%zu, 2=%zu, 3=%zu, 4=%zu\n",
+               ArrowTable_insert_case_counts[1],
+               ArrowTable_insert_case_counts[2],
+               ArrowTable_insert_case_counts[3],
+               ArrowTable_insert_case_counts[4]);
+        memset(ArrowTable_insert_case_counts, 0, sizeof(ArrowTable_insert_case_counts));
+#else
+        printf("Insert cases: n/a (compile with -DARROW_PROFILE)\n");
+#endif
+    }
 
     if ((err = ArrowTable_destroy(&a))) {
         print_error(err);
@@ -102,14 +135,251 @@ run_trace(char const *const trace_path)
     return 0;
 }
 
+/// @brief  Bulk load every PUT in the trace and check that the result matches
+///         the table built by calling 'ArrowTable_put' on each PUT in turn.
+static int
+run_bulk_trace(char const *const trace_path, size_t const nthreads)
+{
+    char op_str[4] = {0};
+    int key = 0, value = 0;
+    int err = 0;
+    int *keys = NULL, *values = NULL;
+    size_t length = 0, capacity = 0;
+    struct ArrowTable bulk = {0};
+    struct ArrowTable oracle = {0};
+
+    assert(trace_path != NULL);
+
+    FILE *fp = fopen(trace_path, "r");
+    if (fp == NULL) {
+        printf("'%s' path DNE\n", trace_path);
+        print_error(errno);
+        return errno;
+    }
+    if ((err = ArrowTable_init(&oracle))) {
+        print_error(err);
+        fclose(fp);
+        return err;
+    }
+    while (fscanf(fp, "%3s %d %d", op_str, &key, &value) == 3) {
+        if (strcmp(op_str, "PUT") != 0)
+            continue;
+        if (length == capacity) {
+            capacity = capacity ? 2 * capacity : 64;
+            keys = realloc(keys, capacity * sizeof(*keys));
+            values = realloc(values, capacity * sizeof(*values));
+            assert(keys != NULL && values != NULL);
+        }
+        keys[length] = key;
+        values[length] = value;
+        ++length;
+        assert(ArrowTable_put(&oracle, key, value) == 0);
+    }
+    fclose(fp);
+
+    if ((err = ArrowTable_bulk_init(&bulk, keys, values, length, nthreads))) {
+        print_error(err);
+        return err;
+    }
+    assert(bulk.length == oracle.length);
+    // Without duplicates, the bulk build must size the table like the puts.
+    if (oracle.length == length) {
+        assert(bulk.capacity == oracle.capacity);
+    }
+    for (size_t i = 0; i < length; ++i) {
+        assert(ArrowTable_get(&bulk, keys[i]) == ArrowTable_get(&oracle, keys[i]));
+    }
+
+    free(keys);
+    free(values);
+    if ((err = ArrowTable_destroy(&bulk)) || (err = ArrowTable_destroy(&oracle))) {
+        print_error(err);
+        return err;
+    }
+    return 0;
+}
+
+/// @brief  Run the trace on the string-keyed table.
+/// @note   We turn every third key into a short (inline) string and the rest
+///         into long strings that live in the arena.
+static int
+run_str_trace(char const *const trace_path)
+{
+    char op_str[4] = {0};
+    char key_str[64] = {0};
+    int key = 0, value = 0, key_length = 0;
+    int err = 0;
+    struct ArrowStrTable a = {0};
+
+    assert(trace_path != NULL);
+
+    if ((err = ArrowStrTable_init(&a))) {
+        print_error(err);
+        return err;
+    }
+
+    FILE *fp = fopen(trace_path, "r");
+    if (fp == NULL) {
+        printf("'%s' path DNE\n", trace_path);
+        print_error(errno);
+        return errno;
+    }
+
+    while (fscanf(fp, "%3s %d %d", op_str, &key, &value) == 3) {
+        if (key % 3 == 0) {
+            key_length = snprintf(key_str, sizeof(key_str), "%d", key);
+        } else {
+            key_length = snprintf(key_str, sizeof(key_str), "/api/v1/users/%d/session", key);
+        }
+        assert(key_length > 0 && key_length < sizeof(key_str));
+        if (strcmp(op_str, "GET") == 0) {
+            assert(ArrowStrTable_get(&a, key_str, key_length) == value);
+        } else if (strcmp(op_str, "PUT") == 0) {
+            assert(ArrowStrTable_put(&a, key_str, key_length, value) == 0);
+        } else {
+            assert(0 && "IMPOSSIBLE!");
+        }
+    }
+    fclose(fp);
+
+    if ((err = ArrowStrTable_destroy(&a))) {
+        print_error(err);
+        return err;
+    }
+    return 0;
+}
+
+/// @brief  Read the resident set size from '/proc/self/statm'.
+/// @return Returns the RSS in bytes, or 0 if it is unavailable.
+static size_t
+read_rss_bytes(void)
+{
+    size_t total_pages = 0, resident_pages = 0;
+    long const page_size = sysconf(_SC_PAGESIZE);
+    FILE *fp = fopen("/proc/self/statm", "r");
+    if (fp == NULL) {
+        return 0;
+    }
+    if (fscanf(fp, "%zu %zu", &total_pages, &resident_pages) != 2 || page_size <= 0) {
+        resident_pages = 0;
+    }
+    fclose(fp);
+    return resident_pages * (size_t)page_size;
+}
+
+enum MemoryLayout {
+    MEMORY_LAYOUT_INT,
+    // String keys of at most ARROW_STR_INLINE_SIZE bytes, stored in the cell.
+    MEMORY_LAYOUT_STR_INLINE,
+    // Longer string keys, stored in the arena.
+    MEMORY_LAYOUT_STR_ARENA,
+    MEMORY_LAYOUT_NUM,
+};
+
+static char const *const MEMORY_LAYOUT_STRINGS[] = {"int", "str_inline", "str_arena"};
+
+/// @brief  Insert up to 'max_entries' distinct keys into each layout and
+///         print a CSV row of the bytes per entry at (roughly) every 10% more
+///         entries. The RSS is relative to before the table was created.
+static int
+run_memory_benchmark(size_t const max_entries)
+{
+    int err = 0;
+    char key_str[32] = {0};
+    struct ArrowTableMemoryUsage usage = {0};
+
+    printf("layout,entries,capacity,live_bytes,reserved_bytes,peak_resize_bytes,rss_bytes,"
+           "reserved_bytes_per_entry,rss_bytes_per_entry\n");
+    for (enum MemoryLayout layout = 0; layout < MEMORY_LAYOUT_NUM; ++layout) {
+        struct ArrowTable a = {0};
+        struct ArrowStrTable s = {0};
+        size_t const base_rss = read_rss_bytes();
+        size_t next_sample = 1, capacity = 0, rss = 0;
+
+        if ((err = layout == MEMORY_LAYOUT_INT ? ArrowTable_init(&a) : ArrowStrTable_init(&s))) {
+            print_error(err);
+            return err;
+        }
+        for (size_t i = 1; i <= max_entries; ++i) {
+            // An odd multiplier is a bijection mod 2^31, so the keys are distinct.
+            int const key = (int)(((uint32_t)i * 2654435761u) & INT32_MAX);
+            int key_length = 0;
+            switch (layout) {
+            case MEMORY_LAYOUT_INT:
+                err = ArrowTable_put(&a, key, 0);
+                break;
+            case MEMORY_LAYOUT_STR_INLINE:
+                key_length = snprintf(key_str, sizeof(key_str), "%x", key);
+                err = ArrowStrTable_put(&s, key_str, key_length, 0);
+                break;
+            case MEMORY_LAYOUT_STR_ARENA:
+                key_length = snprintf(key_str, sizeof(key_str), "/session/%08x", key);
+                err = ArrowStrTable_put(&s, key_str, key_length, 0);
+                break;
+            default:
+                assert(0 && "IMPOSSIBLE!");
+            }
+            if (err) {
+                print_error(err);
+                return err;
+            }
+            if (i != next_sample && i != max_entries) {
+                continue;
+            }
+            next_sample = next_sample + next_sample / 10 + 1;
+            if (layout == MEMORY_LAYOUT_INT) {
+                err = ArrowTable_memory_usage(&a, &usage);
+                capacity = a.capacity;
+            } else {
+                err = ArrowStrTable_memory_usage(&s, &usage);
+                capacity = s.capacity;
+            }
+            assert(err == 0);
+            rss = read_rss_bytes();
+            rss = rss > base_rss ? rss - base_rss : 0;
+            printf("%s,%zu,%zu,%zu,%zu,%zu,%zu,%.2f,%.2f\n",
+                   MEMORY_LAYOUT_STRINGS[layout], i, capacity, usage.live_bytes,
+                   usage.reserved_bytes, usage.peak_resize_bytes, rss,
+                   (double)usage.reserved_bytes / i, (double)rss / i);
+        }
+        ArrowTable_destroy(&a);
+        ArrowStrTable_destroy(&s);
+    }
+    return 0;
+}
+
 int
 main(int argc, char *argv[])
 {
+    // Usage: ./arrow_exe [--profile] <trace>...
+    //        ./arrow_exe --memory [max_entries]
+    struct Profiler profiler = {0};
+    bool profile = false;
+    int first_trace = 1;
+    if (argc > 1 && strcmp(argv[1], "--memory") == 0) {
+        return run_memory_benchmark(argc > 2 ? strtoull(argv[2], NULL, 0) : 1000000);
+    }
+    if (argc > 1 && strcmp(argv[1], "--profile") == 0) {
+        profile = true;
+        first_trace = 2;
+        if (!profiler_init(&profiler)) {
+            LOGGER_WARN("perf counters unavailable, falling back to TSC timing");
+        }
+    }
+
     if (false)
         assert(run_simple_trace() == 0);
     if (true)
-        for (size_t i = 1; i < argc; ++i) {
-            assert(run_trace(argv[i]) == 0);
+        for (size_t i = first_trace; i < argc; ++i) {
+            assert(run_trace(argv[i], profile ? &profiler : NULL) == 0);
+        }
+    if (!profile)
+        for (size_t i = first_trace; i < argc; ++i) {
+            assert(run_bulk_trace(argv[i], 1) == 0);
+            assert(run_bulk_trace(argv[i], 4) == 0);
+            assert(run_str_trace(argv[i]) == 0);
         }
+    if (profile)
+        profiler_destroy(&profiler);
     return 0;
 }
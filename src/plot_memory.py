@@ -0,0 +1,61 @@
+#!/usr/bin/python3
+"""
+@brief  Plot the bytes per entry against the number of entries for each
+        layout, from the CSV printed by './arrow_exe --memory'.
+"""
+
+import argparse
+import csv
+from collections import defaultdict
+from pathlib import Path
+
+
+def read_memory_csv(path: Path) -> dict[str, list[dict[str, float]]]:
+    rows = defaultdict(list)
+    with path.open() as f:
+        for row in csv.DictReader(f):
+            layout = row.pop("layout")
+            rows[layout].append({k: float(v) for k, v in row.items()})
+    return rows
+
+
+def plot_memory(rows: dict[str, list[dict[str, float]]], path: Path):
+    # NOTE We import this here so that reading the CSV does not need matplotlib.
+    import matplotlib
+
+    matplotlib.use("Agg")
+    import matplotlib.pyplot as plt
+
+    fig, ax = plt.subplots(figsize=(10, 6))
+    for layout, samples in rows.items():
+        entries = [s["entries"] for s in samples]
+        (line,) = ax.plot(
+            entries, [s["reserved_bytes_per_entry"] for s in samples], label=f"{layout} (reserved)"
+        )
+        ax.plot(
+            entries,
+            [s["rss_bytes_per_entry"] for s in samples],
+            linestyle="--",
+            color=line.get_color(),
+            label=f"{layout} (RSS)",
+        )
+    ax.set_xscale("log")
+    ax.set_xlabel("Entries")
+    ax.set_ylabel("Bytes per entry")
+    ax.set_title("ArrowTable memory footprint")
+    ax.legend()
+    fig.savefig(path)
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("csv", type=Path, help="path to the CSV from './arrow_exe --memory'")
+    parser.add_argument(
+        "plot", nargs="?", type=Path, default=Path("memory.png"), help="path to output plot"
+    )
+    args = parser.parse_args()
+    plot_memory(read_memory_csv(args.csv), args.plot)
+
+
+if __name__ == "__main__":
+    main()
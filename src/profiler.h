@@ -0,0 +1,215 @@
+/** @brief  Hardware counter profiler for the trace driver.
+ *  @note   This uses Linux's perf_event_open(2) to count user-space events
+ *          around each operation. If the counters are unavailable (e.g. in a
+ *          container or VM, or with a strict perf_event_paranoid), then it
+ *          falls back to timing with the time-stamp counter only.
+ */
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+enum ProfilerCounter {
+    PROFILER_CYCLES,
+    PROFILER_INSTRUCTIONS,
+    PROFILER_LLC_MISSES,
+    PROFILER_BRANCH_MISSES,
+    PROFILER_DTLB_MISSES,
+    PROFILER_NUM_COUNTERS,
+};
+
+static char const *const PROFILER_COUNTER_STRINGS[] =
+    {"cycles", "instructions", "LLC-misses", "branch-misses", "dTLB-misses"};
+
+struct Profiler {
+    // File descriptor of each counter, or -1 if it could not be opened. The
+    // first open counter leads the group so they are all read at once.
+    int fds[PROFILER_NUM_COUNTERS];
+    int leader_fd;
+    // Position of each open counter in a group read.
+    size_t slots[PROFILER_NUM_COUNTERS];
+    size_t num_open;
+};
+
+/// @brief  A snapshot of the counters at the start of an operation.
+/// @note   The 'tsc' delta includes the read(2) of the counters, so it is only
+///         meaningful on its own when the perf counters are unavailable.
+struct ProfilerSample {
+    uint64_t counters[PROFILER_NUM_COUNTERS];
+    // How long the group was enabled and how long it was actually scheduled
+    // on the PMU. These differ if the counters were multiplexed.
+    uint64_t time_enabled;
+    uint64_t time_running;
+    uint64_t tsc;
+};
+
+/// @brief  Accumulated deltas over every operation of one type.
+struct ProfilerTotals {
+    uint64_t counters[PROFILER_NUM_COUNTERS];
+    uint64_t time_enabled;
+    uint64_t time_running;
+    uint64_t tsc;
+    size_t ops;
+};
+
+/// @brief  Read the time-stamp counter (or a nanosecond clock elsewhere).
+static inline uint64_t
+profiler_tsc(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec ts = {0};
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+#endif
+}
+
+#ifdef __linux__
+static inline int
+_profiler_open(uint32_t const type, uint64_t const config, int const group_fd)
+{
+    struct perf_event_attr attr = {0};
+    attr.size = sizeof(attr);
+    attr.type = type;
+    attr.config = config;
+    attr.disabled = group_fd == -1;
+    // NOTE Excluding the kernel keeps the read(2) calls themselves out of
+    //      the counts and works with perf_event_paranoid <= 2.
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED |
+                       PERF_FORMAT_TOTAL_TIME_RUNNING;
+    return (int)syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+}
+#endif
+
+/// @brief  Open whichever counters are available.
+/// @return Returns true if at least one hardware counter is available.
+static inline bool
+profiler_init(struct Profiler *const me)
+{
+    *me = (struct Profiler){.leader_fd = -1};
+    for (size_t i = 0; i < PROFILER_NUM_COUNTERS; ++i) {
+        me->fds[i] = -1;
+    }
+#ifdef __linux__
+    struct {
+        uint32_t type;
+        uint64_t config;
+    } const events[PROFILER_NUM_COUNTERS] = {
+        [PROFILER_CYCLES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+        [PROFILER_INSTRUCTIONS] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+        [PROFILER_LLC_MISSES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+        [PROFILER_BRANCH_MISSES] = {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+        [PROFILER_DTLB_MISSES] = {PERF_TYPE_HW_CACHE,
+                                  PERF_COUNT_HW_CACHE_DTLB |
+                                      (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                      (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)},
+    };
+    for (size_t i = 0; i < PROFILER_NUM_COUNTERS; ++i) {
+        int const fd = _profiler_open(events[i].type, events[i].config, me->leader_fd);
+        if (fd == -1) {
+            continue;
+        }
+        if (me->leader_fd == -1) {
+            me->leader_fd = fd;
+        }
+        me->fds[i] = fd;
+        me->slots[i] = me->num_open++;
+    }
+    if (me->leader_fd != -1) {
+        ioctl(me->leader_fd, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(me->leader_fd, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+#endif
+    return me->num_open != 0;
+}
+
+static inline void
+profiler_destroy(struct Profiler *const me)
+{
+    for (size_t i = 0; i < PROFILER_NUM_COUNTERS; ++i) {
+        if (me->fds[i] != -1) {
+            close(me->fds[i]);
+        }
+    }
+    *me = (struct Profiler){.leader_fd = -1};
+}
+
+/// @brief  Read every open counter and the time-stamp counter.
+static inline void
+profiler_read(struct Profiler const *const me, struct ProfilerSample *const sample)
+{
+    // Format of the read: the count, the time enabled, the time running,
+    // then each value.
+    uint64_t buf[3 + PROFILER_NUM_COUNTERS] = {0};
+    if (me->num_open != 0 &&
+        read(me->leader_fd, buf, (3 + me->num_open) * sizeof(*buf)) > 0) {
+        sample->time_enabled = buf[1];
+        sample->time_running = buf[2];
+        for (size_t i = 0; i < PROFILER_NUM_COUNTERS; ++i) {
+            sample->counters[i] = me->fds[i] != -1 ? buf[3 + me->slots[i]] : 0;
+        }
+    }
+    sample->tsc = profiler_tsc();
+}
+
+/// @brief  Add the events since 'start' to the totals.
+static inline void
+profiler_accumulate(struct Profiler const *const me,
+                    struct ProfilerSample const *const start,
+                    struct ProfilerTotals *const totals)
+{
+    struct ProfilerSample stop = {0};
+    profiler_read(me, &stop);
+    for (size_t i = 0; i < PROFILER_NUM_COUNTERS; ++i) {
+        totals->counters[i] += stop.counters[i] - start->counters[i];
+    }
+    totals->time_enabled += stop.time_enabled - start->time_enabled;
+    totals->time_running += stop.time_running - start->time_running;
+    totals->tsc += stop.tsc - start->tsc;
+    ++totals->ops;
+}
+
+static inline void
+profiler_print(struct Profiler const *const me,
+               char const *const name,
+               struct ProfilerTotals const *const totals,
+               FILE *const stream)
+{
+    double const ops = totals->ops ? (double)totals->ops : 1.0;
+    // If the PMU could not schedule the group the whole time, then scale the
+    // counts up to estimate them. If it never ran, then we know nothing.
+    bool const ran = totals->time_running != 0;
+    bool const scaled = ran && totals->time_running < totals->time_enabled;
+    double const scale = scaled ? (double)totals->time_enabled / totals->time_running : 1.0;
+    fprintf(stream, "%s: ops=%zu, tsc/op=%.1f", name, totals->ops, totals->tsc / ops);
+    for (size_t i = 0; i < PROFILER_NUM_COUNTERS; ++i) {
+        if (me->fds[i] == -1 || !ran) {
+            fprintf(stream, ", %s/op=n/a", PROFILER_COUNTER_STRINGS[i]);
+        } else {
+            fprintf(stream, ", %s/op=%.3f", PROFILER_COUNTER_STRINGS[i], scale * totals->counters[i] / ops);
+        }
+    }
+    if (scaled) {
+        fprintf(stream, " (scaled; counters ran %.1f%% of the time)",
+                100.0 * totals->time_running / totals->time_enabled);
+    }
+    fprintf(stream, "\n");
+}
@@ -0,0 +1,120 @@
+/** @brief  Long-running randomized differential stress test for the ArrowTable.
+ *  @note   Usage: ./stress_exe [seed] [iterations]. Every mutation is checked
+ *          against a reference map and followed by a full invariant check,
+ *          so the table size is cycled to keep each iteration cheap.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "differential.h"
+#include "logger.h"
+
+/// @brief  A small, seedable PRNG (splitmix64) so runs are reproducible.
+static uint64_t
+next_random(uint64_t *const state)
+{
+    uint64_t z = (*state += 0x9e3779b97f4a7c15);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+    return z ^ (z >> 31);
+}
+
+/// @brief  Fill the table with inline keys, then put and remove one arena
+///         key over and over. Check that the arena stays bounded and that we
+///         only compact it once the removed keys outweigh the cells.
+static void
+stress_arena_churn(uint64_t *const state)
+{
+    struct Differential *const diff = differential_new();
+    // Keep the table small enough that the rounds compact it a few times.
+    int const num_keys = 100 + next_random(state) % 1000;
+    int const key = 2 * num_keys + 1;
+    char str_key[32] = {0};
+    size_t const key_length = _differential_str_key(key, str_key, sizeof(str_key));
+    size_t const rounds = 5000;
+    size_t compactions = 0, dead_bytes = 0;
+
+    if (diff == NULL) {
+        LOGGER_FATAL("out of memory");
+        exit(1);
+    }
+    // Even keys are stored inline, so only the churned key uses the arena.
+    for (int key = 0; key < 2 * num_keys; key += 2) {
+        differential_step(diff, DIFFERENTIAL_PUT, key, key);
+    }
+    for (size_t i = 0; i < rounds; ++i) {
+        struct ArrowStrArena const *const arena = &diff->str_table.arena;
+        size_t const cell_bytes = diff->str_table.capacity * sizeof(*diff->str_table.data);
+        size_t const prev_dead_length = arena->dead_length;
+
+        differential_step(diff, DIFFERENTIAL_PUT, key, (int)i);
+        compactions += arena->dead_length < prev_dead_length;
+        differential_step(diff, DIFFERENTIAL_REMOVE, key, 0);
+        dead_bytes += key_length;
+        // The put before a compaction may add one more dead key.
+        if (arena->dead_length > cell_bytes + key_length) {
+            LOGGER_FATAL("arena grew to %zu bytes (%zu dead) with %zu bytes of cells",
+                         arena->length, arena->dead_length, cell_bytes);
+            exit(1);
+        }
+        // Each compaction must reclaim more bytes than there are cells.
+        if (compactions * cell_bytes > dead_bytes) {
+            LOGGER_FATAL("compacted %zu times for %zu dead bytes with %zu bytes of cells",
+                         compactions, dead_bytes, cell_bytes);
+            exit(1);
+        }
+    }
+    LOGGER_INFO("arena churn: num_keys=%d, rounds=%zu, compactions=%zu", num_keys, rounds, compactions);
+    differential_free(diff);
+}
+
+int
+main(int argc, char *argv[])
+{
+    uint64_t state = argc > 1 ? strtoull(argv[1], NULL, 0) : 0;
+    size_t const iterations = argc > 2 ? strtoull(argv[2], NULL, 0) : 1000000;
+    struct Differential *diff = NULL;
+    // Each round uses a different key range and stride, so we see sparse
+    // tables, dense tables, long collision runs, and runs that wrap around.
+    size_t const round_length = 20000;
+    int num_keys = 0, stride = 0;
+
+    LOGGER_INFO("seed=%llu, iterations=%zu", (unsigned long long)state, iterations);
+    stress_arena_churn(&state);
+    for (size_t i = 0; i < iterations; ++i) {
+        if (i % round_length == 0) {
+            if (diff != NULL) {
+                differential_check_all(diff, DIFFERENTIAL_MAX_KEY);
+                differential_free(diff);
+            }
+            diff = differential_new();
+            if (diff == NULL) {
+                LOGGER_FATAL("out of memory");
+                return 1;
+            }
+            num_keys = 1 + next_random(&state) % 2000;
+            stride = 1 + next_random(&state) % 32;
+            if (num_keys * stride >= DIFFERENTIAL_MAX_KEY) {
+                stride = (DIFFERENTIAL_MAX_KEY - 1) / num_keys;
+            }
+            LOGGER_DEBUG("round %zu: num_keys=%d, stride=%d", i / round_length, num_keys, stride);
+        }
+        uint64_t const r = next_random(&state);
+        // Bias towards puts so the table fills up and grows.
+        enum DifferentialOp op = (r % 16 < 7) ? DIFFERENTIAL_PUT
+                               : (r % 16 < 11) ? DIFFERENTIAL_GET
+                                               : DIFFERENTIAL_REMOVE;
+        if (r % 4096 == 0) {
+            op = DIFFERENTIAL_BULK;
+        }
+        int const key = (int)((r >> 8) % num_keys) * stride;
+        int const value = (int)((r >> 32) % 1000000);
+        differential_step(diff, op, key, value);
+    }
+    if (diff != NULL) {
+        differential_check_all(diff, DIFFERENTIAL_MAX_KEY);
+        differential_free(diff);
+    }
+    LOGGER_INFO("passed %zu iterations", iterations);
+    return 0;
+}